@@ -0,0 +1,267 @@
+#include <string>
+#include <vector>
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include "TH1F.h"
+#include "TF1.h"
+#include "TGraph.h"
+#include "TMath.h"
+#include "TRandom3.h"
+#include "TROOT.h"
+#include "TFitResult.h"
+#include "Math/MinimizerOptions.h"
+
+#include "../Coincidences/countCoincidences.cpp"
+#include "../General-Purpose/streamSeed.cpp"
+
+using namespace std;
+
+
+// central value and confidence interval of a bootstrapped quantity
+struct BootstrapResult {
+  double value    = 0;  // value on the original data
+  double low      = 0;  // lower limit of the confidence interval
+  double high     = 0;  // upper limit of the confidence interval
+  double err      = 0;  // standard deviation of the replicas
+  int    n_failed = 0;  // replicas whose fit did not converge
+};
+
+void prepareThreads(int& n_threads, string& minimizer, string& algo);
+void restoreMinimizer(const string& minimizer, const string& algo);
+void fillInterval(BootstrapResult& res, vector<double> replicas, double cl);
+
+
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//  Estimates the uncertainty on the number of events in the photopeak of a  //
+//  coincidence histogram (see "countCoincidences") by Poisson resampling    //
+//  of its bins. Each replica is refit with a gaussian + linear background   //
+//  on a thread pool: every thread owns its copy of the histogram and of     //
+//  the fit function, and the fits use Minuit2 so that no ROOT global state  //
+//  is shared. The default minimizer of the session is restored at the end.  //
+//  Each replica has its own random stream, hence the result does not        //
+//  depend on the number of threads.                                         //
+//                                                                           //
+//  Input parameters:                                                        //
+//    - "h" (TH1F*) = coincidence histogram, e.g. as returned by             //
+//        "countCoincidences" through "h_out"                                //
+//    - "xmin_fit" and "xmax_fit" (double) = range of gaussian+linear fit    //
+//    - "n_replicas" (int) = number of bootstrap replicas.                   //
+//        Defaults to 1000                                                   //
+//    - "n_threads" (int) = number of threads, 0 uses all cores.             //
+//        Defaults to 0                                                      //
+//    - "seed" (UInt_t) = seed of the random streams. Defaults to 12345      //
+//    - "cl" (double) = confidence level of the interval.                    //
+//        Defaults to 0.6827                                                 //
+//    - "replicas" (vector<double>*) = optional, if given it is filled with  //
+//        the value of each replica (NaN if the fit failed), e.g. to         //
+//        propagate them with "bootstrapGraphFit"                            //
+//                                                                           //
+//  Output:                                                                  //
+//    - BootstrapResult with N and its confidence interval                   //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+BootstrapResult bootstrapPhotopeak(TH1F* h, double xmin_fit, double xmax_fit,
+                                   int n_replicas = 1000, int n_threads = 0,
+                                   UInt_t seed = 12345, double cl = 0.6827,
+                                   vector<double>* replicas = nullptr) {
+
+  string minimizer, algo;
+  prepareThreads(n_threads, minimizer, algo);
+  double bin_width = h->GetXaxis()->GetBinWidth(1);
+  int n_bins = h->GetNbinsX();
+
+  // nominal fit
+  TF1* f = getFunction("lingaus", h, xmin_fit, xmax_fit);
+  h->Fit(f, "QNR");
+  BootstrapResult res;
+  res.value = photopeakCounts(f->GetParameters(), bin_width);
+  vector<double> nominal(f->GetParameters(), f->GetParameters() + f->GetNpar());
+
+  // per-thread copies, created before any thread is started
+  vector<TH1F*> h_thr(n_threads);
+  vector<TF1*>  f_thr(n_threads);
+  for(int t = 0; t < n_threads; t++) {
+    h_thr[t] = (TH1F*) h->Clone((string(h->GetName()) + "_bs" + to_string(t)).c_str());
+    h_thr[t]->SetDirectory(nullptr);
+    f_thr[t] = (TF1*) f->Clone((string(f->GetName()) + "_bs" + to_string(t)).c_str());
+  }
+
+  // run replicas on the thread pool
+  vector<double> values(n_replicas);
+  atomic<int> next_replica(0);
+  vector<thread> pool;
+  for(int t = 0; t < n_threads; t++) {
+    pool.emplace_back([&, t]() {
+      TRandom3 rng;
+      int r;
+      while((r = next_replica++) < n_replicas) {
+        rng.SetSeed(streamSeed(seed, r));
+        for(int bin = 1; bin <= n_bins; bin++) {
+          double n = rng.Poisson(h->GetBinContent(bin));
+          h_thr[t]->SetBinContent(bin, n);
+          h_thr[t]->SetBinError(bin, TMath::Sqrt(n));
+        }
+        f_thr[t]->SetParameters(&nominal[0]);
+        TFitResultPtr r_fit = h_thr[t]->Fit(f_thr[t], "QNSR");
+        values[r] = (int(r_fit) == 0) ?
+          photopeakCounts(f_thr[t]->GetParameters(), bin_width) : TMath::QuietNaN();
+      }
+    });
+  }
+  for(int t = 0; t < n_threads; t++) {
+    pool[t].join();
+  }
+
+  restoreMinimizer(minimizer, algo);
+  fillInterval(res, values, cl);
+  if(replicas) *replicas = values;
+
+  for(int t = 0; t < n_threads; t++) {
+    delete h_thr[t];
+    delete f_thr[t];
+  }
+  delete f;
+
+  return res;
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//  Propagates bootstrap replicas of the points of a graph to a parameter    //
+//  of a function fit to it, e.g. the DeltaE of the double sigmoid in        //
+//  "findDeltaE". Replica r of the graph is made of the r-th replica of each //
+//  point and is refit on a thread pool with per-thread graph and function   //
+//  copies; replicas containing a failed point are skipped. As in            //
+//  "bootstrapPhotopeak", the default minimizer is restored at the end.      //
+//                                                                           //
+//  Input parameters:                                                        //
+//    - "x" (vector<double>) = x coordinates of the points                   //
+//    - "y" (vector<double>) = nominal y coordinates of the points           //
+//    - "y_replicas" (vector<vector<double>>) = replicas of each point,      //
+//        indexed as [point][replica]                                        //
+//    - "func" (TF1*) = fit function, with initial parameters set            //
+//    - "par" (int) = index of the parameter of interest                     //
+//    - "n_threads" (int) = number of threads, 0 uses all cores.             //
+//        Defaults to 0                                                      //
+//    - "cl" (double) = confidence level of the interval.                    //
+//        Defaults to 0.6827                                                 //
+//                                                                           //
+//  Output:                                                                  //
+//    - BootstrapResult with the parameter and its confidence interval       //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+BootstrapResult bootstrapGraphFit(const vector<double>& x, const vector<double>& y,
+                                  const vector<vector<double>>& y_replicas,
+                                  TF1* func, int par, int n_threads = 0,
+                                  double cl = 0.6827) {
+
+  string minimizer, algo;
+  prepareThreads(n_threads, minimizer, algo);
+  int n = x.size();
+  int n_replicas = y_replicas[0].size();
+
+  // nominal fit
+  vector<double> init(func->GetParameters(), func->GetParameters() + func->GetNpar());
+  TGraph* graph = new TGraph(n, &x[0], &y[0]);
+  graph->Fit(func, "QNR");
+  BootstrapResult res;
+  res.value = func->GetParameter(par);
+
+  // per-thread copies, created before any thread is started
+  vector<TGraph*> g_thr(n_threads);
+  vector<TF1*>    f_thr(n_threads);
+  for(int t = 0; t < n_threads; t++) {
+    g_thr[t] = new TGraph(n, &x[0], &y[0]);
+    f_thr[t] = (TF1*) func->Clone((string(func->GetName()) + "_bs" + to_string(t)).c_str());
+  }
+
+  // run replicas on the thread pool
+  vector<double> values(n_replicas);
+  atomic<int> next_replica(0);
+  vector<thread> pool;
+  for(int t = 0; t < n_threads; t++) {
+    pool.emplace_back([&, t]() {
+      int r;
+      while((r = next_replica++) < n_replicas) {
+        bool valid = true;
+        for(int i = 0; i < n; i++) {
+          if(TMath::IsNaN(y_replicas[i][r])) valid = false;
+          g_thr[t]->SetPoint(i, x[i], y_replicas[i][r]);
+        }
+        if(!valid) {
+          values[r] = TMath::QuietNaN();
+          continue;
+        }
+        f_thr[t]->SetParameters(&init[0]);
+        TFitResultPtr r_fit = g_thr[t]->Fit(f_thr[t], "QNSR");
+        values[r] = (int(r_fit) == 0) ?
+          f_thr[t]->GetParameter(par) : TMath::QuietNaN();
+      }
+    });
+  }
+  for(int t = 0; t < n_threads; t++) {
+    pool[t].join();
+  }
+
+  restoreMinimizer(minimizer, algo);
+  fillInterval(res, values, cl);
+
+  for(int t = 0; t < n_threads; t++) {
+    delete g_thr[t];
+    delete f_thr[t];
+  }
+  delete graph;
+
+  return res;
+}
+
+
+
+
+// set number of threads and make ROOT and the fits safe to use from them,
+// returning the default minimizer to be restored afterwards
+void prepareThreads(int& n_threads, string& minimizer, string& algo) {
+  if(n_threads <= 0) n_threads = thread::hardware_concurrency();
+  if(n_threads <= 0) n_threads = 1;
+  ROOT::EnableThreadSafety();
+  // TMinuit keeps a global instance, Minuit2 does not
+  minimizer = ROOT::Math::MinimizerOptions::DefaultMinimizerType();
+  algo      = ROOT::Math::MinimizerOptions::DefaultMinimizerAlgo();
+  ROOT::Math::MinimizerOptions::SetDefaultMinimizer("Minuit2");
+}
+
+
+// set back the default minimizer saved by prepareThreads
+void restoreMinimizer(const string& minimizer, const string& algo) {
+  ROOT::Math::MinimizerOptions::SetDefaultMinimizer(minimizer.c_str(), algo.c_str());
+}
+
+
+// compute standard deviation and percentile interval of the valid replicas
+void fillInterval(BootstrapResult& res, vector<double> replicas, double cl) {
+  vector<double> valid;
+  for(int r = 0; r < replicas.size(); r++) {
+    if(TMath::IsNaN(replicas[r])) res.n_failed++;
+    else valid.push_back(replicas[r]);
+  }
+  if(valid.size() < 2) {
+    cout << "Error : not enough valid bootstrap replicas" << endl;
+    return;
+  }
+  sort(valid.begin(), valid.end());
+
+  int m = valid.size();
+  int i_low  = TMath::Nint((1 - cl)/2*(m - 1));
+  int i_high = TMath::Nint((1 + cl)/2*(m - 1));
+  res.low  = valid[i_low];
+  res.high = valid[i_high];
+  res.err  = TMath::RMS(m, &valid[0]);
+}
@@ -6,7 +6,7 @@
 #include "TH1D.h"
 #include "TF1.h"
 
-#include "../Coincidences/countCoincidences.cpp"
+#include "bootstrapErrors.cpp"
 
 using namespace std;	     
 
@@ -34,18 +34,35 @@ using namespace std;
 //        execution. It accepts the following substrings (case sensitive):   //
 //          "save" constrols whether to save or not the energy histogram     //
 //          "draw" ???????? to be implememted                                //
+//          "bootstrap" computes confidence intervals on the yields and on   //
+//          DeltaE by Poisson resampling of the coincidence histograms       //
+//    - "mc_table" (string) = optional table written by "simulateEfficiency" //
+//        used to correct the yields for efficiency and angular correlation. //
+//        If empty, eta = W_theta = 1. The MC error is printed along with    //
+//        each yield and, with "bootstrap", every replica is also divided    //
+//        by a gaussian fluctuation of eta*W_theta, common to all runs       //
+//    - "mc_source" (string) = source name in the MC table.                  //
+//        Defaults to "Na22"                                                 //
+//    - "mc_distance" (double) = source-detector distance in the MC table    //
+//        [cm]. Defaults to 10                                               //
+//    - "n_replicas" (int) = number of bootstrap replicas. Defaults to 1000  //
 //                                                                           //
 //  Output:                                                                  //
 //    - (double) DeltaE                                                      //
 //                                                                           //
 ///////////////////////////////////////////////////////////////////////////////
 
-double findDeltaE(string file_list, string options = "draw") {
+double findDeltaE(string file_list, string options = "draw",
+                  string mc_table = "", string mc_source = "Na22",
+                  double mc_distance = 10, int n_replicas = 1000) {
 
-  double N_p = 1, eta = 1, W_theta = 1;
+  // number of photons emitted in the line (two per decay for Na22),
+  // the normalisation of eta and W_theta in "simulateEfficiency"
+  double N_p = 1;
   
   bool save = (options.find("save") != string::npos);
   bool draw = (options.find("draw") != string::npos);
+  bool bootstrap = (options.find("bootstrap") != string::npos);
   
   // read input file list
   ifstream fin(file_list);
@@ -71,16 +88,54 @@ double findDeltaE(string file_list, string options = "draw") {
   } 
   
   
+  // get efficiency and angular correlation of the photopeak in the fit range
+  MCCorrection mc;
+  if(!mc_table.empty()) {
+    mc = getMCCorrection(mc_table, mc_source, mc_distance,
+                         (xmin_fit + xmax_fit)/2, 0);
+  }
+  
+  // fluctuations of the MC correction, one per bootstrap replica
+  double mc_rel = mc.relErr();
+  vector<double> mc_scale(n_replicas, 1);
+  if(bootstrap && mc_rel > 0) {
+    TRandom3 rng_mc(54321);
+    for(int r = 0; r < n_replicas; r++) {
+      mc_scale[r] = rng_mc.Gaus(1, mc_rel);
+    }
+  }
+  
   // compute number of events in coincidence
   vector<double> Y;
+  vector<vector<double>> Y_replicas;
   for(int i = 0; i < input_files.size(); i++) {
     TFile* file = new TFile(input_files[i].c_str(), "UPDATE");
+    TH1F* h = nullptr;
     double N = countCoincidences(file, tree_names[i], bin_number, xmin, xmax,
-                                 0, time_diff, xmin_fit, xmax_fit, save);
-    double y = N/(N_p*eta*W_theta);
+                                 0, time_diff, xmin_fit, xmax_fit, save, &mc,
+                                 bootstrap ? &h : nullptr);
+    double y = N/N_p;
     Y.push_back(y);
     
-    cout << y << endl;
+    cout << y << " +- " << y*mc_rel << " (MC)" << endl;
+    
+    // resample the in-memory histogram to get the yield uncertainty
+    if(bootstrap) {
+      vector<double> replicas;
+      BootstrapResult bs = bootstrapPhotopeak(h, xmin_fit, xmax_fit,
+                                              n_replicas, 0, 12345 + i,
+                                              0.6827, &replicas);
+      double scale = 1/(N_p*mc.eta*mc.W_theta);
+      for(int r = 0; r < replicas.size(); r++) {
+        replicas[r] *= scale/mc_scale[r];
+      }
+      Y_replicas.push_back(replicas);
+      BootstrapResult bs_y;
+      fillInterval(bs_y, replicas, 0.6827);
+      cout << "  68% CI: [" << bs_y.low << ", " << bs_y.high
+           << "], failed fits: " << bs.n_failed << endl;
+      delete h;
+    }
     
     delete file;
   }
@@ -88,7 +143,7 @@ double findDeltaE(string file_list, string options = "draw") {
   
   // Fit Results //
   
-  int n = 7; //Y.size();
+  int n = Y.size();
   double* Y_arr = &Y[0];
   double* Ep_arr = &E_p[0];
   TGraph* graph = new TGraph(n, Ep_arr, Y_arr);
@@ -106,10 +161,19 @@ double findDeltaE(string file_list, string options = "draw") {
   double c = E_p[0];
   double d = E_p[n-1] - E_p[0];
   step->SetParameters(m, a, c, b, d, q);
+  TF1* step_init = (TF1*) step->Clone("step_init");
   
   // fit
   TFitResultPtr r_fit = graph->Fit(step, "SR");
   
+  // propagate the yield replicas to DeltaE
+  if(bootstrap) {
+    BootstrapResult bs = bootstrapGraphFit(E_p, Y, Y_replicas, step_init, 4);
+    cout << "DeltaE = " << r_fit->Parameter(4) << ", 68% CI: [" << bs.low
+         << ", " << bs.high << "], failed fits: " << bs.n_failed << endl;
+  }
+  delete step_init;
+  
   return r_fit->Parameter(4);
 }
   
@@ -4,9 +4,12 @@
 #include "TF1.h"
 
 #include "../General-Purpose/getFunction.cpp"
+#include "../Simulation/readMCTable.cpp"
 
 using namespace std;	     
 
+double photopeakCounts(const double* par, double bin_width);
+
 
 ///////////////////////////////////////////////////////////////////////////////
 //                                                                           //
@@ -23,6 +26,12 @@ using namespace std;
 //        consider two events in coincidence                                 //
 //    - "xmin_fit" and "xmax_ft" (double) = range of gaussian+linear bkg fit //
 //    - "save" (bool) = wheter to save the histogram or not                  //
+//    - "mc" (MCCorrection*) = optional efficiency and angular correlation   //
+//        factors from "simulateEfficiency". If given, the number of events  //
+//        is divided by eta*W_theta                                          //
+//    - "h_out" (TH1F**) = optional, if given it is set to a copy of the     //
+//        coincidence histogram detached from the file, e.g. to resample it  //
+//        with "bootstrapPhotopeak"                                          //
 //                                                                           //
 //  Output:                                                                  //
 //    - (double) number of events in the photopeak                           //
@@ -31,7 +40,8 @@ using namespace std;
 
 double countCoincidences(TFile* file, string tree_name, int bin_number,
                          double xmin, double xmax, int ch, double time_diff = 16000,
-                         double xmin_fit = 450, double xmax_fit = 540, bool save = true) {
+                         double xmin_fit = 450, double xmax_fit = 540, bool save = true,
+                         const MCCorrection* mc = nullptr, TH1F** h_out = nullptr) {
                          
   double bin_width = (xmax - xmin)/bin_number;
 
@@ -46,19 +56,30 @@ double countCoincidences(TFile* file, string tree_name, int bin_number,
   if(save) {
     h->Write(hist_name.c_str(), TObject::kOverwrite);
   }
+  if(h_out) {
+    *h_out = (TH1F*) h->Clone((hist_name + "_copy").c_str());
+    (*h_out)->SetDirectory(nullptr);
+  }
 
   // compute number of events in photopeak
   string funcname = "lingaus";
   TF1* f = getFunction(funcname.c_str(), h, xmin_fit, xmax_fit);
   TFitResultPtr r_fit = h->Fit(f, "SR"); 
-  TF1* bkg = new TF1("bkg", "pol1(0)", xmin_fit, xmax_fit);
-  bkg->SetParNames("q", "m");
-  bkg->SetParameters(r_fit->Parameter(3), r_fit->Parameter(4));
-  
-  double N = (f->Integral(r_fit->Parameter(1) - 3*r_fit->Parameter(2),
-                          r_fit->Parameter(1) + 3*r_fit->Parameter(2)) -
-              bkg->Integral(r_fit->Parameter(1) - 3*r_fit->Parameter(2),
-                            r_fit->Parameter(1) + 3*r_fit->Parameter(2)))/bin_width;
+  double N = photopeakCounts(f->GetParameters(), bin_width);
+
+  // correct for detection efficiency and angular correlation
+  if(mc) {
+    N /= mc->eta*mc->W_theta;
+  }
                             
   return N;   
   }
+
+
+
+// number of events under the gaussian of a "lingaus" fit within 3 sigma,
+// i.e. integral of the fit minus the linear background
+double photopeakCounts(const double* par, double bin_width) {
+  double sigma = TMath::Abs(par[2]);
+  return par[0]*sigma*TMath::Sqrt(TMath::TwoPi())*TMath::Erf(3/TMath::Sqrt2())/bin_width;
+}
@@ -0,0 +1,327 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <deque>
+#include <algorithm>
+#include <iostream>
+#include "TFile.h"
+#include "TTree.h"
+#include "TMath.h"
+#include "TMatrixDSym.h"
+#include "TVectorD.h"
+
+using namespace std;
+
+
+// per-channel time offsets [ps], to be subtracted from the time stamps
+struct TimeCalibration {
+  map<int, double> offset;
+  map<int, double> offset_err;
+
+  static int id(int board, int ch) { return board*256 + ch; }
+
+  double get(int board, int ch) const {
+    auto it = offset.find(id(board, ch));
+    return (it != offset.end()) ? it->second : 0;
+  }
+};
+
+bool peakPosition(const vector<double>& counts, double xmin, double bin_width,
+                  double& pos, double& pos_err);
+
+
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//  Computes the time offset of every (board, channel) pair in a single      //
+//  pass over a time-sorted TTree, either in ascending or descending order   //
+//  (an unsorted TTree is rejected). For each event, the time differences    //
+//  with the previous events of the other channels within "window" are       //
+//  filled in a Delta t histogram for each pair of channels. The position    //
+//  of each peak (centroid within twice its FWHM, background subtracted)     //
+//  gives the relative offset of the pair, and the offsets of all channels   //
+//  are obtained at once by a weighted least squares fit of these            //
+//  differences. Only the largest group of channels linked to each other by  //
+//  resolved peaks is fitted, with its first channel as reference (offset    //
+//  0): the other channels are left uncalibrated (offset 0, not saved) with  //
+//  a warning.                                                               //
+//  The calibration is saved as a TTree "time_calib_<tree name>" with        //
+//  branches "board", "channel", "offset" and "offset_err" [ps].             //
+//                                                                           //
+//  Input parameters:                                                        //
+//    - "tree" (TTree*) = pointer to the time-sorted TTree                   //
+//    - "time_var" (string) = name of branch corresponding to event time.    //
+//        Defaults to "time_stamp"                                           //
+//    - "channel_var" (string) = name of branch corresponding to the         //
+//        channel. Defaults to "channel"                                     //
+//    - "board_var" (string) = name of branch corresponding to the board.    //
+//        Defaults to "board"                                                //
+//    - "window" (double) = maximum time difference considered [ps].         //
+//        Defaults to 1e5                                                    //
+//    - "bin_number" (int) = number of bins of the Delta t histograms.       //
+//        Defaults to 2000                                                   //
+//    - "save" (bool) = if true, saves the calibration TTree.                //
+//        Defaults to "true"                                                 //
+//                                                                           //
+//  Output:                                                                  //
+//    - TimeCalibration with the offset of each calibrated (board, channel)  //
+//      pair                                                                 //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+TimeCalibration timeCalibration(TTree* tree, string time_var = "time_stamp",
+                                string channel_var = "channel",
+                                string board_var = "board", double window = 1e5,
+                                int bin_number = 2000, bool save = true) {
+
+  TimeCalibration tcal;
+  double bin_width = 2*window/bin_number;
+
+  ULong64_t ts = 0;
+  UShort_t  ch = 0, bd = 0;
+  if (tree->SetBranchAddress(time_var.c_str(),    &ts) < 0 ||
+      tree->SetBranchAddress(channel_var.c_str(), &ch) < 0 ||
+      tree->SetBranchAddress(board_var.c_str(),   &bd) < 0) {
+    cout << "Error : missing branch in " << tree->GetName()
+         << ", no time calibration" << endl;
+    tree->ResetBranchAddresses();
+    return tcal;
+  }
+
+  // Delta t histograms t_b - t_a for each pair of channels (a < b),
+  // indexed by id_a*65536 + id_b
+  map<int, vector<double>> counts;
+  set<int> channels;
+  deque<pair<ULong64_t, int>> recent;
+  int order = 0;  // +1 ascending, -1 descending, 0 not known yet
+
+  Long64_t nentries = tree->GetEntries();
+  for (Long64_t i = 0; i < nentries; i++) {
+    tree->GetEntry(i);
+    int id = TimeCalibration::id(bd, ch);
+    channels.insert(id);
+
+    // check the time order against the previous event
+    if (!recent.empty() && ts != recent.back().first) {
+      int step = (ts > recent.back().first) ? 1 : -1;
+      if (order == 0) order = step;
+      if (step != order) {
+        cout << "Error : " << tree->GetName() << " is not sorted by time, "
+             << "no time calibration" << endl;
+        tree->ResetBranchAddresses();
+        return tcal;
+      }
+    }
+
+    // drop events outside the window
+    while (!recent.empty() &&
+           TMath::Abs((double) (Long64_t) (ts - recent.front().first)) >= window) {
+      recent.pop_front();
+    }
+
+    for (int j = 0; j < recent.size(); j++) {
+      int id_old = recent[j].second;
+      if (id_old == id) continue;
+      double dt = (double) (Long64_t) (ts - recent[j].first);
+      int key = (id_old < id) ? id_old*65536 + id : id*65536 + id_old;
+      if (id_old > id) dt = -dt;
+
+      vector<double>& h = counts[key];
+      if (h.empty()) h.resize(bin_number, 0);
+      int bin = (int) ((dt + window)/bin_width);
+      if (bin >= 0 && bin < bin_number) h[bin]++;
+    }
+    recent.push_back(make_pair(ts, id));
+  }
+  tree->ResetBranchAddresses();
+
+  if (channels.size() < 2) {
+    cout << "Error : less than two channels, no time calibration" << endl;
+    return tcal;
+  }
+
+  // relative offsets of the pairs with a resolved peak
+  struct PairDt { int a, b; double d, w; };
+  vector<PairDt> pairs;
+  map<int, vector<int>> linked;
+  for (auto it = counts.begin(); it != counts.end(); it++) {
+    double d, d_err;
+    if (!peakPosition(it->second, -window, bin_width, d, d_err)) continue;
+    int a = it->first / 65536, b = it->first % 65536;
+    pairs.push_back({a, b, d, 1/(d_err*d_err)});
+    linked[a].push_back(b);
+    linked[b].push_back(a);
+
+    cout << "Pair " << a << " - " << b
+         << ": Delta t = " << d << " +- " << d_err << " ps" << endl;
+  }
+
+  // largest group of channels linked by the pairs, the first one is the
+  // reference: the fit is only determined within such a group
+  vector<int> ids;
+  set<int> visited;
+  for (auto it = channels.begin(); it != channels.end(); it++) {
+    if (visited.count(*it)) continue;
+    vector<int> group(1, *it);
+    visited.insert(*it);
+    for (int k = 0; k < group.size(); k++) {
+      vector<int>& next = linked[group[k]];
+      for (int j = 0; j < next.size(); j++) {
+        if (visited.insert(next[j]).second) group.push_back(next[j]);
+      }
+    }
+    if (group.size() > ids.size()) ids = group;
+  }
+  sort(ids.begin(), ids.end());
+  int n = ids.size();
+  if (n < 2) {
+    cout << "Error : no coincidence peak between any two channels, "
+         << "no time calibration" << endl;
+    return tcal;
+  }
+
+  map<int, int> index;
+  for (int k = 0; k < n; k++) {
+    index[ids[k]] = k;
+  }
+  for (auto it = channels.begin(); it != channels.end(); it++) {
+    if (index.count(*it)) continue;
+    cout << "Warning : board " << *it / 256 << " ch " << *it % 256
+         << " not linked to board " << ids[0] / 256 << " ch " << ids[0] % 256
+         << " by any coincidence peak, left uncalibrated" << endl;
+  }
+
+  // normal equations of the weighted least squares fit
+  // sum_pairs w*(o_b - o_a - d_ab)^2, with o_ref = 0.
+  // The group is connected, hence the matrix is positive definite
+  TMatrixDSym A(n - 1);
+  TVectorD r(n - 1);
+  for (int k = 0; k < pairs.size(); k++) {
+    if (!index.count(pairs[k].a) || !index.count(pairs[k].b)) continue;
+    int a = index[pairs[k].a] - 1;
+    int b = index[pairs[k].b] - 1;
+    double w = pairs[k].w, d = pairs[k].d;
+
+    if (a >= 0) { A(a, a) += w; r(a) -= w*d; }
+    if (b >= 0) { A(b, b) += w; r(b) += w*d; }
+    if (a >= 0 && b >= 0) { A(a, b) -= w; A(b, a) -= w; }
+  }
+
+  A.Invert();
+  TVectorD o = A*r;
+
+  tcal.offset[ids[0]]     = 0;
+  tcal.offset_err[ids[0]] = 0;
+  for (int k = 1; k < n; k++) {
+    tcal.offset[ids[k]]     = o(k - 1);
+    tcal.offset_err[ids[k]] = TMath::Sqrt(A(k - 1, k - 1));
+  }
+
+  // store calibration
+  if (save) {
+    UShort_t board, channel;
+    Double_t offset, offset_err;
+    string calibname = "time_calib_" + string(tree->GetName());
+    TTree* tree_calib = new TTree(calibname.c_str(), "Time offsets [ps]");
+    tree_calib->Branch("board",      &board,      "board/s");
+    tree_calib->Branch("channel",    &channel,    "channel/s");
+    tree_calib->Branch("offset",     &offset,     "offset/D");
+    tree_calib->Branch("offset_err", &offset_err, "offset_err/D");
+    for (int k = 0; k < n; k++) {
+      board      = ids[k] / 256;
+      channel    = ids[k] % 256;
+      offset     = tcal.offset[ids[k]];
+      offset_err = tcal.offset_err[ids[k]];
+      tree_calib->Fill();
+    }
+    tree_calib->Write(calibname.c_str(), TObject::kOverwrite);
+    delete tree_calib;
+  }
+
+  return tcal;
+}
+
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//  Reads a time calibration saved by "timeCalibration".                     //
+//                                                                           //
+//  Input parameters:                                                        //
+//    - "file" (TFile*) = pointer to the .root file containing the           //
+//        calibration TTree                                                  //
+//    - "calibname" (string) = name of the calibration TTree                 //
+//                                                                           //
+//  Output:                                                                  //
+//    - TimeCalibration, with no offsets if the TTree is not found           //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+TimeCalibration readTimeCalibration(TFile* file, string calibname) {
+
+  TimeCalibration tcal;
+  TTree* tree_calib = (TTree*) file->Get(calibname.c_str());
+  if (!tree_calib) {
+    cout << "Error : time calibration " << calibname << " not found" << endl;
+    return tcal;
+  }
+
+  UShort_t board, channel;
+  Double_t offset, offset_err;
+  tree_calib->SetBranchAddress("board",      &board);
+  tree_calib->SetBranchAddress("channel",    &channel);
+  tree_calib->SetBranchAddress("offset",     &offset);
+  tree_calib->SetBranchAddress("offset_err", &offset_err);
+  for (Long64_t i = 0; i < tree_calib->GetEntries(); i++) {
+    tree_calib->GetEntry(i);
+    tcal.offset[TimeCalibration::id(board, channel)]     = offset;
+    tcal.offset_err[TimeCalibration::id(board, channel)] = offset_err;
+  }
+
+  return tcal;
+}
+
+
+
+
+// centroid of the peak of a histogram within twice its FWHM around the
+// maximum, after subtracting the background estimated from the outer 10%
+// of the bins on each side; false if the peak has too few counts
+bool peakPosition(const vector<double>& counts, double xmin, double bin_width,
+                  double& pos, double& pos_err) {
+  int n = counts.size();
+  int n_side = TMath::Max(1, n/10);
+  double bkg = 0;
+  for (int i = 0; i < n_side; i++) {
+    bkg += counts[i] + counts[n - 1 - i];
+  }
+  bkg /= 2*n_side;
+
+  int max = 0;
+  for (int i = 1; i < n; i++) {
+    if (counts[i] > counts[max]) max = i;
+  }
+  double half = (counts[max] - bkg)/2;
+  int lo = max, hi = max;
+  while (lo > 0     && counts[lo - 1] - bkg > half) lo--;
+  while (hi < n - 1 && counts[hi + 1] - bkg > half) hi++;
+  int width = hi - lo + 1;
+  lo = TMath::Max(0, lo - width/2 - 1);
+  hi = TMath::Min(n - 1, hi + width/2 + 1);
+
+  double sum = 0, sum_x = 0, sum_x2 = 0;
+  for (int i = lo; i <= hi; i++) {
+    double w = counts[i] - bkg;
+    double x = xmin + (i + 0.5)*bin_width;
+    sum    += w;
+    sum_x  += w*x;
+    sum_x2 += w*x*x;
+  }
+  if (sum < 50) return false;
+
+  pos = sum_x/sum;
+  double rms = TMath::Sqrt(TMath::Max(sum_x2/sum - pos*pos, bin_width*bin_width/12));
+  pos_err = rms/TMath::Sqrt(sum);
+  return true;
+}
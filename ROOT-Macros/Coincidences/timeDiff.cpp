@@ -2,9 +2,11 @@
 #include <iostream>
 #include "TTree.h"
 
+#include "timeCalibration.cpp"
+
 using namespace std;	
 
-Int_t findMinDt(Int_t i, ULong64_t* t, UShort_t* c, Long64_t& dt_min,
+Int_t findMinDt(Int_t i, Long64_t* t, UShort_t* c, Long64_t& dt_min,
                	bool& chk_coinc, Int_t min, Int_t max);
 
 
@@ -15,6 +17,7 @@ Int_t findMinDt(Int_t i, ULong64_t* t, UShort_t* c, Long64_t& dt_min,
 //  other channel and builds a TTree to store coincidence information.       //
 //  The new TTree contains the following branches:                           // 
 //    - "channel" (unisgned short) = channel the mesurement was taken in     //
+//    - "board" (unsigned short) = board the measurement was taken in        //
 //    - "energy_main" (int) = energy measurement                             //
 //    - "count_main" (unsigned short) = number of times the event was part   //
 //        of a coincidence                                                   //
@@ -35,6 +38,16 @@ Int_t findMinDt(Int_t i, ULong64_t* t, UShort_t* c, Long64_t& dt_min,
 //        channel. Deafualts to "channel"                                    //
 //    - "save" (bool) = if true, saves coincidence TTree.                    //
 //        Defaults to "true"                                                 //    
+//    - "tcal" (TimeCalibration*) = optional per-channel time offsets from   //
+//        "timeCalibration", subtracted from the time stamps as they are     //
+//        read. The corrected times are sorted again before looking for      //
+//        coincidences, so the output follows the corrected time order       //
+//    - "board_var" (string) = name of branch corresponding to the board.    //
+//        Events are told apart by (board, channel); if the branch is        //
+//        missing all events are on board 0. Defaults to "board"             //
+//    - "window" (double) = maximum time difference [ps] for an event to     //
+//        count as a coincidence in "count_main" and "count_coinc".          //
+//        Defaults to 20000                                                  //
 //                                                                           //
 //  Output:                                                                  //
 //    - TTree* pointing to coincidences TTree                                //
@@ -43,20 +56,24 @@ Int_t findMinDt(Int_t i, ULong64_t* t, UShort_t* c, Long64_t& dt_min,
 
 TTree* timeDiff(TTree* tree, string time_var = "time_stamp",
                 string energy_var = "energy_ch", string channel_var = "channel",
-                bool save = true) {
+                bool save = true, const TimeCalibration* tcal = nullptr,
+                string board_var = "board", double window = 20000) {
                 
   bool not_calib = strcmp("energy_calib", energy_var.c_str()); 
 
   // get time stamps and channel arrays
   Int_t nentries = (Int_t) tree->GetEntries();
-  ULong64_t* t       = new ULong64_t[nentries];
+  Long64_t* t        = new Long64_t[nentries];
   UShort_t* e        = new UShort_t[nentries];
   Double_t* e_calib  = new Double_t[nentries];
   UShort_t* c        = new UShort_t[nentries];
+  UShort_t* b        = new UShort_t[nentries];
+  UShort_t* id       = new UShort_t[nentries];
   ULong64_t ts;
   UShort_t  en;
   Double_t en_calib;
   UShort_t  ch;
+  UShort_t  bd = 0;
   tree->SetBranchAddress(time_var.c_str(),    &ts);
   if(not_calib) {
     tree->SetBranchAddress(energy_var.c_str(),  &en);
@@ -65,9 +82,15 @@ TTree* timeDiff(TTree* tree, string time_var = "time_stamp",
     tree->SetBranchAddress(energy_var.c_str(),  &en_calib);
   }
   tree->SetBranchAddress(channel_var.c_str(), &ch);
+  if(tree->GetBranch(board_var.c_str())) {
+    tree->SetBranchAddress(board_var.c_str(), &bd);
+  }
   for (Int_t i = 0; i < nentries; i++) {
     tree->GetEntry(i);
-    t[i] = ts;
+    t[i] = (Long64_t) ts;
+    if(tcal) {
+      t[i] -= (Long64_t) TMath::Nint(tcal->get(bd, ch));
+    }
     if(not_calib) {
       e[i] = en;
     }
@@ -75,13 +98,43 @@ TTree* timeDiff(TTree* tree, string time_var = "time_stamp",
       e_calib[i] = en_calib;
     }
     c[i] = ch;
+    b[i] = bd;
+    id[i] = TimeCalibration::id(bd, ch);
+  }
+  tree->ResetBranchAddresses();
+
+  // the offsets change the time order: sort the events again
+  if(tcal) {
+    Int_t* index = new Int_t[nentries];
+    TMath::Sort(nentries, t, index, kFALSE);
+    Long64_t* t_s = new Long64_t[nentries];
+    UShort_t* e_s = new UShort_t[nentries];
+    Double_t* e_calib_s = new Double_t[nentries];
+    UShort_t* c_s = new UShort_t[nentries];
+    UShort_t* b_s = new UShort_t[nentries];
+    UShort_t* id_s = new UShort_t[nentries];
+    for (Int_t i = 0; i < nentries; i++) {
+      t_s[i]       = t[index[i]];
+      e_s[i]       = e[index[i]];
+      e_calib_s[i] = e_calib[index[i]];
+      c_s[i]       = c[index[i]];
+      b_s[i]       = b[index[i]];
+      id_s[i]      = id[index[i]];
+    }
+    delete[] t;       t = t_s;
+    delete[] e;       e = e_s;
+    delete[] e_calib; e_calib = e_calib_s;
+    delete[] c;       c = c_s;
+    delete[] b;       b = b_s;
+    delete[] id;      id = id_s;
+    delete[] index;
   }
   
   // create arrays for index of event in coincidence in the other channel,
   // number of coincidences for the single event and time differences
   Int_t* ev_coinc = new Int_t[nentries];
   Int_t* n_coinc  = new Int_t[nentries];
-  ULong64_t* dt_coinc = new ULong64_t[nentries];
+  Long64_t* dt_coinc = new Long64_t[nentries];
   for (Int_t i = 0; i < nentries; i++) {
     ev_coinc[i] = -1;
     n_coinc[i]  = 0;
@@ -93,10 +146,10 @@ TTree* timeDiff(TTree* tree, string time_var = "time_stamp",
     Long64_t dt_min = 1e18;
     bool chk_coinc = false;
   
-    Int_t index = findMinDt(i, t, c, dt_min, chk_coinc, -1, nentries);
+    Int_t index = findMinDt(i, t, id, dt_min, chk_coinc, -1, nentries);
     if (chk_coinc) {
       ev_coinc[i] = index;
-      if (TMath::Abs(dt_min) < 20000) {
+      if (TMath::Abs(dt_min) < window) {
       	n_coinc[index] += 1;
       }
       dt_coinc[i] = dt_min;
@@ -104,7 +157,7 @@ TTree* timeDiff(TTree* tree, string time_var = "time_stamp",
   }
  
   // create new TTree to store coincidence information
-  UShort_t channel;
+  UShort_t channel, board;
   UShort_t energy_main, energy_coinc;
   Double_t energy_calib_main, energy_calib_coinc;
   Int_t  count_main, count_coinc;
@@ -116,6 +169,7 @@ TTree* timeDiff(TTree* tree, string time_var = "time_stamp",
   
   TTree* tree_coinc = new TTree(coincname.c_str(), coinctitle.c_str());
   tree_coinc->Branch("channel",      &channel,      "channel/s");
+  tree_coinc->Branch("board",        &board,        "board/s");
   if(not_calib) {
     tree_coinc->Branch("energy_main",  &energy_main,  "energy_main/s");
     tree_coinc->Branch("energy_coinc", &energy_coinc, "energy_coinc/s");
@@ -134,6 +188,7 @@ TTree* timeDiff(TTree* tree, string time_var = "time_stamp",
     bool chk_coinc = (ev_coinc[i] != -1);
     if (chk_coinc) {
       channel = c[i];
+      board = b[i];
       if (not_calib) {
         energy_main = e[i];
         energy_coinc =  e[ev_coinc[i]];
@@ -159,6 +214,8 @@ TTree* timeDiff(TTree* tree, string time_var = "time_stamp",
   delete[] e;
   delete[] e_calib;
   delete[] c;
+  delete[] b;
+  delete[] id;
   delete[] ev_coinc;
   delete[] n_coinc;
   delete[] dt_coinc; 
@@ -170,7 +227,7 @@ TTree* timeDiff(TTree* tree, string time_var = "time_stamp",
 
 
 // find index of closest event both in past and future
-Int_t findMinDt(Int_t i, ULong64_t* t, UShort_t* c, Long64_t& dt_min,
+Int_t findMinDt(Int_t i, Long64_t* t, UShort_t* c, Long64_t& dt_min,
          	bool& chk_coinc, Int_t min, Int_t max) {
   Long64_t dt;
   Int_t index;
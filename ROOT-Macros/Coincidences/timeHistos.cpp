@@ -8,6 +8,7 @@
 using namespace std;
 
 double meanInRange(TH1F* h, int min, int length);
+double peakCentroid(TH1F* h, double bkg);
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -23,6 +24,11 @@ double meanInRange(TH1F* h, int min, int length);
 //    - "ch" (int) = channel number                                          //
 //    - "path" (string) = path where to save the image.                      //
 //        Defaults to "ProcessedData/Images/"                                //
+//    - "window" (double) = half width of the acceptance window [ps]. Can    //
+//        be tightened once the time offsets are calibrated, see             //
+//        "timeCalibration". Defaults to 16000                               //
+//    - "board" (int) = board number, -1 takes channel "ch" of every         //
+//        board. Defaults to -1                                              //
 //                                                                           //
 //  Output:                                                                  //
 //    - void                                                                 //
@@ -30,7 +36,8 @@ double meanInRange(TH1F* h, int min, int length);
 ///////////////////////////////////////////////////////////////////////////////
 
 void timeHistos(TFile* file , string treename, int ch,
-                string path = "ProcessedData/Images/") {
+                string path = "ProcessedData/Images/", double window = 16e3,
+                int board = -1) {
 
   TTree* tree = (TTree*) file->Get(treename.c_str())->Clone(); 
   
@@ -46,10 +53,16 @@ void timeHistos(TFile* file , string treename, int ch,
   // make time difference histograms
   string histname = "hist_timeDiff_" + runID + "_" + to_string(ch);
   string histtitle = runID + ": Time Differences ch " + to_string(ch);
+  string selection = "channel == " + to_string(ch);
+  if (board >= 0) {
+    histname  = "hist_timeDiff_" + runID + "_" + to_string(board) + "_" + to_string(ch);
+    histtitle = runID + ": Time Differences board " + to_string(board) +
+                " ch " + to_string(ch);
+    selection += " && board == " + to_string(board);
+  }
   TH1F* h = new TH1F(histname.c_str(), histtitle.c_str(),
                      100, -1e5, 1e5);
-  tree->Draw(("time_diff>>" + histname).c_str(),
-             ("channel == " + to_string(ch)).c_str());
+  tree->Draw(("time_diff>>" + histname).c_str(), selection.c_str());
   h->GetXaxis()->SetTitle("#Delta t [ps]");
   h->GetYaxis()->SetTitle("Counts / 2 ns");
      
@@ -59,9 +72,10 @@ void timeHistos(TFile* file , string treename, int ch,
   // FIT //
   
   // define fit function:
-  // constant background + exponential on  both sides
-  int binmax = h->GetMaximumBin();
-  double center = h->GetXaxis()->GetBinCenter(binmax);
+  // constant background + exponential on  both sides,
+  // centred on the centroid of the peak
+  double bkg = (meanInRange(h, 1, 25) + meanInRange(h, 76, 25)) / 2;
+  double center = peakCentroid(h, bkg);
   string fleft =  "[0] + [1]*exp((x - (" + to_string(center) + ") + [2])/[3])";
   string fright = "[0] + [1]*exp((-1*(x - (" + to_string(center) + ")) +  [2])/[3])";
   string limleft  = "(x < "  + to_string(center) + ")";
@@ -72,7 +86,6 @@ void timeHistos(TFile* file , string treename, int ch,
   func->SetParNames("Constant", "a", "x0", "tau");
     
   // set initial parameters
-  double bkg = (meanInRange(h, 1, 25) + meanInRange(h, 76, 25)) / 2;
   double tau = 1e3;
   func->SetParameters(bkg, 1, center, tau);
 
@@ -107,13 +120,13 @@ void timeHistos(TFile* file , string treename, int ch,
   TH1F* h_left = new TH1F("left_reject", "Left Rejection Region",
                           100, -1e5, 1e5);
   tree->Draw("time_diff>>left_reject",
-             ("channel == " + to_string(ch) + " && " +
-              "time_diff < " + to_string(-16e3)).c_str(), "goff");
+             (selection + " && " +
+              "time_diff < " + to_string(-window)).c_str(), "goff");
   TH1F* h_right = new TH1F("right_reject", "Right Rejection Region",
                            100, -1e5, 1e5);
   tree->Draw("time_diff>>right_reject",
-             ("channel == " + to_string(ch) + " && " +
-              "time_diff > " + to_string(16e3)).c_str(), "goff");
+             (selection + " && " +
+              "time_diff > " + to_string(window)).c_str(), "goff");
   h_left->SetLineColor(kBlack);
   h_left->SetFillColor(kRed);
   h_left->SetFillStyle(3003);
@@ -153,3 +166,23 @@ double meanInRange(TH1F* h, int min, int length) {
   sum /= length;
   return sum;
 }
+
+
+// background subtracted centroid of the bins around the maximum that are
+// above half of its height
+double peakCentroid(TH1F* h, double bkg) {
+  int binmax = h->GetMaximumBin();
+  double half = (h->GetBinContent(binmax) - bkg) / 2;
+  int lo = binmax, hi = binmax;
+  while (lo > 1 && h->GetBinContent(lo - 1) - bkg > half) lo--;
+  while (hi < h->GetNbinsX() && h->GetBinContent(hi + 1) - bkg > half) hi++;
+
+  double sum = 0, sum_x = 0;
+  for (int i = TMath::Max(1, lo - 1); i <= TMath::Min(h->GetNbinsX(), hi + 1); i++) {
+    double w = TMath::Max(h->GetBinContent(i) - bkg, 0.);
+    sum   += w;
+    sum_x += w*h->GetXaxis()->GetBinCenter(i);
+  }
+  if (sum <= 0) return h->GetXaxis()->GetBinCenter(binmax);
+  return sum_x / sum;
+}
@@ -0,0 +1,85 @@
+#include <vector>
+#include <atomic>
+#include <thread>
+
+
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//  Lock-free single-producer / single-consumer ring buffer. The slots are   //
+//  allocated once and reused: the producer fills the slot returned by       //
+//  "beginPush" in place and publishes it with "endPush", the consumer       //
+//  reads the slot returned by "front" and releases it with "pop". Only one  //
+//  thread may push and only one thread may pop.                             //
+//                                                                           //
+//  Template parameters:                                                     //
+//    - "T" = type of the slots, e.g. a batch of decoded records             //
+//                                                                           //
+//  Constructor parameters:                                                  //
+//    - "capacity" (size_t) = number of slots                                //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+template <class T>
+class RingBuffer {
+
+ public:
+  RingBuffer(size_t capacity) : slots(capacity + 1), head(0), tail(0),
+                                is_closed(false) {}
+
+  // producer: slot to be filled, nullptr if the buffer is full
+  T* beginPush() {
+    size_t h = head.load(std::memory_order_relaxed);
+    if(next(h) == tail.load(std::memory_order_acquire)) return nullptr;
+    return &slots[h];
+  }
+
+  // producer: publish the slot obtained with "beginPush"
+  void endPush() {
+    head.store(next(head.load(std::memory_order_relaxed)),
+               std::memory_order_release);
+  }
+
+  // producer: wait for a free slot
+  T* waitPush() {
+    T* slot;
+    while(!(slot = beginPush())) std::this_thread::yield();
+    return slot;
+  }
+
+  // producer: no more slots will be pushed
+  void close() {
+    is_closed.store(true, std::memory_order_release);
+  }
+
+  // consumer: oldest published slot, nullptr if the buffer is empty
+  T* front() {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if(t == head.load(std::memory_order_acquire)) return nullptr;
+    return &slots[t];
+  }
+
+  // consumer: wait for a slot, nullptr once the producer closed the buffer
+  // and every slot has been consumed
+  T* waitFront() {
+    T* slot;
+    while(!(slot = front())) {
+      if(is_closed.load(std::memory_order_acquire)) return front();
+      std::this_thread::yield();
+    }
+    return slot;
+  }
+
+  // consumer: release the slot obtained with "front"
+  void pop() {
+    tail.store(next(tail.load(std::memory_order_relaxed)),
+               std::memory_order_release);
+  }
+
+ private:
+  size_t next(size_t i) const { return (i + 1) % slots.size(); }
+
+  std::vector<T> slots;
+  alignas(64) std::atomic<size_t> head;  // written by the producer only
+  alignas(64) std::atomic<size_t> tail;  // written by the consumer only
+  std::atomic<bool> is_closed;
+};
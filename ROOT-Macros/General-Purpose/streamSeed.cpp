@@ -0,0 +1,28 @@
+#include "Rtypes.h"
+
+
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//  Computes the seed of an independent random stream from a global seed     //
+//  and the index of the stream (e.g. a chunk of MC histories or a           //
+//  bootstrap replica), mixing the bits with splitmix64 so that nearby       //
+//  indices give uncorrelated TRandom3 sequences. Results obtained with      //
+//  these seeds do not depend on how the streams are shared among threads.   //
+//                                                                           //
+//  Input variables:                                                         //
+//    - "seed" (UInt_t) = global seed                                        //
+//    - "index" (Long64_t) = index of the stream                             //
+//                                                                           //
+//  Output:                                                                  //
+//    - UInt_t seed of the stream, never 0 (random seed in ROOT)             //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+UInt_t streamSeed(UInt_t seed, Long64_t index) {
+  ULong64_t z = ((ULong64_t) seed << 32) + index + 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z =  z ^ (z >> 31);
+  UInt_t s = (UInt_t) z;
+  return (s == 0) ? 1 : s;
+}
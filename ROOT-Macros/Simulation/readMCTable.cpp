@@ -0,0 +1,87 @@
+#include <string>
+#include <iostream>
+#include <fstream>
+#include "TMath.h"
+
+using namespace std;
+
+
+// efficiency and angular correlation factors for a single (source, distance,
+// photopeak, channel) combination, as written by "simulateEfficiency"
+struct MCCorrection {
+  double eta         = 1;
+  double eta_err     = 0;
+  double W_theta     = 1;
+  double W_theta_err = 0;
+
+  // relative error of the product eta*W_theta, summing the two in
+  // quadrature: conservative, since eta*W_theta is the coincidence
+  // probability itself and its error is smaller
+  double relErr() const {
+    return TMath::Sqrt(TMath::Power(eta_err/eta, 2) +
+                       TMath::Power(W_theta_err/W_theta, 2));
+  }
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//  Reads the table produced by "simulateEfficiency" and returns the         //
+//  coincidence efficiency and angular correlation factor for the requested  //
+//  source, distance and channel. Among the matching rows the one whose      //
+//  photopeak energy is closest to "energy" is selected.                     //
+//  The coincidences in the photopeak are N_p * eta * W_theta, with N_p the  //
+//  number of photons emitted in that line (two per decay for Na22).         //
+//                                                                           //
+//  Input parameters:                                                        //
+//    - "table" (string) = name of the .txt table written by                 //
+//        "simulateEfficiency"                                               //
+//    - "source" (string) = source name, e.g. "Co60" or "Na22"               //
+//    - "distance" (double) = source-detector distance [cm]                  //
+//    - "energy" (double) = photopeak energy in the main channel [keV]       //
+//    - "ch" (int) = channel of the photopeak                                //
+//                                                                           //
+//  Output:                                                                  //
+//    - MCCorrection containing eta and W_theta with their errors. If no     //
+//      row matches, eta = W_theta = 1 and an error message is printed       //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+MCCorrection getMCCorrection(string table, string source, double distance,
+                             double energy, int ch) {
+
+  MCCorrection corr;
+
+  ifstream fin(table);
+  if(!fin) {
+    cout << "Error while reading MC table " << table << endl;
+    return corr;
+  }
+
+  // skip header line
+  string header;
+  getline(fin, header);
+
+  string src;
+  double d, e, eta, eta_err, W, W_err;
+  int c;
+  double best = -1;
+  while(fin >> src >> d >> e >> c >> eta >> eta_err >> W >> W_err) {
+    if(src != source || c != ch || TMath::Abs(d - distance) > 1e-3) continue;
+    double de = TMath::Abs(e - energy);
+    if(best < 0 || de < best) {
+      best = de;
+      corr.eta         = eta;
+      corr.eta_err     = eta_err;
+      corr.W_theta     = W;
+      corr.W_theta_err = W_err;
+    }
+  }
+
+  if(best < 0) {
+    cout << "Error : no MC entry for " << source << " at " << distance
+         << " cm, ch " << ch << endl;
+  }
+
+  return corr;
+}
@@ -0,0 +1,317 @@
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include "TMath.h"
+#include "TRandom3.h"
+
+#include "../General-Purpose/streamSeed.cpp"
+
+using namespace std;
+
+struct MCSource;
+struct MCTally;
+void simulateChunk(const MCSource& src, double R, double L, Long64_t n,
+                   UInt_t seed, MCTally& tally);
+
+
+// gamma lines and detector geometry of a single source configuration
+struct MCSource {
+  string name;
+  double distance;  // cm
+  double E[2];      // keV
+  double mu[2];     // total linear attenuation coefficient [1/cm]
+  double pf[2];     // fraction of interactions ending in the photopeak
+};
+
+// counters filled by the simulation, indexed by [gamma][channel]
+struct MCTally {
+  Long64_t n = 0;
+  Long64_t peak[2][2]  = {{0, 0}, {0, 0}};
+  Long64_t total[2][2] = {{0, 0}, {0, 0}};
+  Long64_t coinc[2][2] = {{0, 0}, {0, 0}};
+
+  void add(const MCTally& t) {
+    n += t.n;
+    for(int i = 0; i < 2; i++) {
+      for(int ch = 0; ch < 2; ch++) {
+        peak[i][ch]  += t.peak[i][ch];
+        total[i][ch] += t.total[i][ch];
+        coinc[i][ch] += t.coinc[i][ch];
+      }
+    }
+  }
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+//  Multithreaded Monte Carlo of the two LaBr3 detectors facing each other   //
+//  at 180 deg with the source in the middle. For each history the two       //
+//  gammas of the cascade are emitted, the second one following the          //
+//  angular correlation of the source:                                       //
+//    "Co60" W(theta) = 1 + 1/8 cos^2(theta) + 1/24 cos^4(theta)             //
+//    "Na22" back-to-back 511 keV annihilation photons                       //
+//  A gamma interacts in a crystal with probability 1 - exp(-mu*l), l being  //
+//  its path length in the cylinder, and the interaction ends in the         //
+//  photopeak with probability pf. The photon transport inside the crystal   //
+//  is not simulated: pf is an input, to be taken e.g. from the measured     //
+//  peak-to-total ratio of each line, and its uncertainty is not included    //
+//  in the errors below.                                                     //
+//  For each photopeak and channel the macro computes                        //
+//    eta     = eta_peak(ch) * eta_tot(other ch) for isotropic emission      //
+//    W_theta = eta_coinc(ch) / eta                                          //
+//  so that the number of coincidences in the photopeak of channel "ch" is   //
+//  N_p * eta * W_theta, as used by "findDeltaE" and "countCoincidences".    //
+//  All the probabilities are per emitted photon of the line, hence N_p is   //
+//  the number of photons of that line, not of decays: for Na22, with two    //
+//  511 keV photons per decay, N_p is twice the number of decays.            //
+//  The coincidences are a subset of the photopeak counts, so the errors     //
+//  are propagated from the multinomial counts of each history (peak in      //
+//  "ch" or not, interaction in the other channel or not), keeping the       //
+//  correlation between the estimates.                                       //
+//                                                                           //
+//  Histories are split in chunks of fixed size, each with its own TRandom3  //
+//  seeded from (seed, chunk index), and the chunks are shared among the     //
+//  threads: the results only depend on the seed, not on the number of       //
+//  threads.                                                                 //
+//                                                                           //
+//  Input parameters:                                                        //
+//    - "file_list" (string) = name of .txt file containing the simulation   //
+//        settings, the geometry, the output table name and the sources to   //
+//        simulate. They must be listed in the following order:              //
+//          <histories> <threads (0 = all cores)> <seed>                     //
+//          <crystal radius [cm]> <crystal length [cm]>                      //
+//          <output table>                                                   //
+//          <source #1 name> <distance #1 [cm]>                              //
+//            <E1 [keV]> <mu1 [1/cm]> <pf1> <E2 [keV]> <mu2 [1/cm]> <pf2>    //
+//          ...                                                              //
+//        Lines starting with "#" are ignored                                //
+//    - "verbose" (bool) = whether to print the results to console.          //
+//        Defaults to "true"                                                 //
+//                                                                           //
+//  Output:                                                                  //
+//    - void, the table is written to <output table> with one row per        //
+//      source, distance, photopeak and channel:                             //
+//        <source> <distance> <E> <ch> <eta> <eta err> <W_theta> <W err>     //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+void simulateEfficiency(string file_list, bool verbose = true) {
+
+  const Long64_t chunk_size = 1000000;
+
+  // read input file list, dropping comment lines
+  ifstream fin_list(file_list);
+  if(!fin_list) {
+    cout << "Error while reading input files list" <<endl;
+    return;
+  }
+  stringstream fin;
+  string line;
+  while(getline(fin_list, line)) {
+    size_t first = line.find_first_not_of(" \t");
+    if(first != string::npos && line[first] == '#') continue;
+    fin << line << "\n";
+  }
+  Long64_t histories;
+  int n_threads;
+  UInt_t seed;
+  double R, L;
+  string output_table;
+  fin >> histories >> n_threads >> seed >> R >> L >> output_table;
+
+  vector<MCSource> sources;
+  MCSource s;
+  while(fin >> s.name >> s.distance >> s.E[0] >> s.mu[0] >> s.pf[0]
+                                    >> s.E[1] >> s.mu[1] >> s.pf[1]) {
+    sources.push_back(s);
+  }
+
+  if(n_threads <= 0) n_threads = thread::hardware_concurrency();
+  if(n_threads <= 0) n_threads = 1;
+
+  ofstream fout(output_table);
+  fout << "source  distance  E  ch  eta  eta_err  W_theta  W_theta_err" << endl;
+
+  for(int k = 0; k < sources.size(); k++) {
+    const MCSource& src = sources[k];
+    Long64_t n_chunks = (histories + chunk_size - 1)/chunk_size;
+
+    // run chunks on the thread pool, each thread keeps its own tally
+    vector<MCTally> tallies(n_threads);
+    atomic<Long64_t> next_chunk(0);
+    vector<thread> pool;
+    for(int t = 0; t < n_threads; t++) {
+      pool.emplace_back([&, t]() {
+        Long64_t chunk;
+        while((chunk = next_chunk++) < n_chunks) {
+          Long64_t n = TMath::Min(chunk_size, histories - chunk*chunk_size);
+          simulateChunk(src, R, L, n, streamSeed(seed, chunk), tallies[t]);
+        }
+      });
+    }
+    for(int t = 0; t < n_threads; t++) {
+      pool[t].join();
+    }
+
+    MCTally tot;
+    for(int t = 0; t < n_threads; t++) {
+      tot.add(tallies[t]);
+    }
+
+    // write one row per photopeak and channel
+    // (for identical lines, e.g. Na22, the first gamma is enough: the
+    // probabilities are per photon of the line)
+    double N = tot.n;
+    int n_lines = (src.E[0] == src.E[1]) ? 1 : 2;
+    for(int i = 0; i < n_lines; i++) {
+      for(int ch = 0; ch < 2; ch++) {
+        double p_peak  = tot.peak[i][ch]/N;
+        double p_tot   = tot.total[1-i][1-ch]/N;
+        double p_coinc = tot.coinc[i][ch]/N;
+        double eta = p_peak*p_tot;
+        double W   = (eta > 0) ? p_coinc/eta : 0;
+
+        // delta method on the multinomial cells of each history:
+        // p11 = peak and other total, p10 = peak only, p01 = other total only.
+        // log(eta) = log(p11 + p10) + log(p11 + p01)
+        // log(W)   = log(p11) - log(p11 + p10) - log(p11 + p01)
+        // Var(log f) = (sum_k g_k^2 p_k - (sum_k g_k p_k)^2)/N, g = dlog f/dp
+        double eta_err = 0, W_err = 0;
+        if(p_coinc > 0) {
+          double p11 = p_coinc;
+          double p10 = p_peak - p_coinc;
+          double p01 = p_tot  - p_coinc;
+
+          double g11 = 1/p_peak + 1/p_tot, g10 = 1/p_peak, g01 = 1/p_tot;
+          double var_eta = (g11*g11*p11 + g10*g10*p10 + g01*g01*p01 - 4)/N;
+
+          g11 = 1/p11 - 1/p_peak - 1/p_tot;
+          double var_W = (g11*g11*p11 + g10*g10*p10 + g01*g01*p01 - 1)/N;
+
+          eta_err = eta*TMath::Sqrt(TMath::Max(var_eta, 0.));
+          W_err   = W*TMath::Sqrt(TMath::Max(var_W, 0.));
+        }
+
+        fout << src.name << "  " << src.distance << "  " << src.E[i] << "  "
+             << ch << "  " << eta << "  " << eta_err << "  "
+             << W << "  " << W_err << endl;
+
+        if(verbose) {
+          cout << src.name << " at " << src.distance << " cm, E = "
+               << src.E[i] << " keV, ch " << ch << ": eta = " << eta
+               << " +- " << eta_err << ", W_theta = " << W << " +- "
+               << W_err << endl;
+        }
+      }
+    }
+  }
+
+  fout.close();
+
+  return;
+}
+
+
+
+
+// simulate n histories of a source and add the counts to the tally
+void simulateChunk(const MCSource& src, double R, double L, Long64_t n,
+                   UInt_t seed, MCTally& tally) {
+
+  // local counters, merged at the end to avoid false sharing between threads
+  MCTally local;
+  TRandom3 rng(seed);
+  bool co60 = (src.name == "Co60");
+  bool na22 = (src.name == "Na22");
+  double d = src.distance;
+
+  // W(theta) maximum, for rejection sampling
+  double W_max = 1 + 1./8 + 1./24;
+
+  for(Long64_t h = 0; h < n; h++) {
+
+    // first gamma: isotropic
+    double u[2][3];
+    double cth = 2*rng.Rndm() - 1;
+    double sth = TMath::Sqrt(1 - cth*cth);
+    double phi = TMath::TwoPi()*rng.Rndm();
+    u[0][0] = sth*TMath::Cos(phi);
+    u[0][1] = sth*TMath::Sin(phi);
+    u[0][2] = cth;
+
+    // second gamma: angle w.r.t. the first one from W(theta)
+    if(na22) {
+      for(int j = 0; j < 3; j++) u[1][j] = -u[0][j];
+    }
+    else {
+      double c;
+      if(co60) {
+        do {
+          c = 2*rng.Rndm() - 1;
+        } while(W_max*rng.Rndm() > 1 + c*c/8 + c*c*c*c/24);
+      }
+      else {
+        c = 2*rng.Rndm() - 1;
+      }
+      double s = TMath::Sqrt(1 - c*c);
+      double ph = TMath::TwoPi()*rng.Rndm();
+
+      // orthonormal basis (e1, e2, u0) around the first direction
+      double e1[3], e2[3];
+      if(TMath::Abs(u[0][2]) < 0.9) {
+        double norm = TMath::Sqrt(u[0][0]*u[0][0] + u[0][1]*u[0][1]);
+        e1[0] = -u[0][1]/norm; e1[1] = u[0][0]/norm; e1[2] = 0;
+      }
+      else {
+        double norm = TMath::Sqrt(u[0][1]*u[0][1] + u[0][2]*u[0][2]);
+        e1[0] = 0; e1[1] = -u[0][2]/norm; e1[2] = u[0][1]/norm;
+      }
+      e2[0] = u[0][1]*e1[2] - u[0][2]*e1[1];
+      e2[1] = u[0][2]*e1[0] - u[0][0]*e1[2];
+      e2[2] = u[0][0]*e1[1] - u[0][1]*e1[0];
+      for(int j = 0; j < 3; j++) {
+        u[1][j] = c*u[0][j] + s*(TMath::Cos(ph)*e1[j] + TMath::Sin(ph)*e2[j]);
+      }
+    }
+
+    // track both gammas: channel 0 at z < 0, channel 1 at z > 0
+    bool peak[2][2]  = {{false, false}, {false, false}};
+    bool total[2][2] = {{false, false}, {false, false}};
+    for(int i = 0; i < 2; i++) {
+      double uz = u[i][2];
+      if(uz == 0) continue;
+      int ch = (uz > 0) ? 1 : 0;
+      double az  = TMath::Abs(uz);
+      double rho = TMath::Sqrt(u[i][0]*u[i][0] + u[i][1]*u[i][1]);
+
+      // path length in the cylinder d < |z| < d + L, r < R
+      double t_in  = d/az;
+      double t_out = (d + L)/az;
+      if(rho > 0) t_out = TMath::Min(t_out, R/rho);
+      double l = t_out - t_in;
+      if(l <= 0) continue;
+
+      if(rng.Rndm() < 1 - TMath::Exp(-src.mu[i]*l)) {
+        total[i][ch] = true;
+        if(rng.Rndm() < src.pf[i]) peak[i][ch] = true;
+      }
+    }
+
+    // update counters
+    for(int i = 0; i < 2; i++) {
+      for(int ch = 0; ch < 2; ch++) {
+        if(peak[i][ch])  local.peak[i][ch]++;
+        if(total[i][ch]) local.total[i][ch]++;
+        if(peak[i][ch] && total[1-i][1-ch]) local.coinc[i][ch]++;
+      }
+    }
+  }
+
+  local.n = n;
+  tally.add(local);
+}